@@ -0,0 +1,101 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include "index.h"
+
+// header page of a B+-tree index file
+struct BTreeHdr
+{
+  int		offset;		// the attribute indexed
+  int		length;
+  Datatype	type;
+  int		rootPage;
+  int		height;		// levels, 1 if the root is a leaf
+  int		numEntries;
+};
+
+// A node of the tree, one per page.  A leaf holds sorted (key, RID)
+// entries and is chained to the next leaf.  An inner node holds
+// child0 and sorted (key, RID, child) entries: an entry is the least
+// of its child's subtree, and child0 holds everything below the
+// first.  Keys are compared with compareKeys, then by RID.
+struct BTNode
+{
+  int		level;		// 0 for a leaf
+  int		numKeys;
+  int		nextLeaf;	// next leaf, -1 if last or not a leaf
+  int		child0;
+  char		entries[PAGESIZE - 4 * sizeof(int)];
+};
+
+static_assert(sizeof(BTNode) <= PAGESIZE, "BTNode must fit on a page");
+
+// longest key a node can hold at least four entries of
+const int BTMAXKEY = (PAGESIZE - 4 * sizeof(int)) / 4
+		     - sizeof(RID) - sizeof(int);
+
+// nodes built by a bulk load are filled this many percent, leaving
+// room for later inserts
+const int BTFILLPCT = 90;
+
+// A B+-tree index over a heap file attribute.  The tree is latched as
+// a whole through its header page: exclusively by inserts and deletes,
+// shared while a scan collects the matches of a leaf.  Deletes leave
+// nodes as sparse as they make them; empty leaves stay in the chain.
+class BTreeIndex : public Index
+{
+public:
+  BTreeIndex(const IndexDesc & desc, Status & status);
+  ~BTreeIndex();
+
+  // create the index file desc names and load it, bottom up, with the
+  // records of the scan, which must have been started unfiltered
+  static const Status build(const IndexDesc & desc, HeapFileScan & scan);
+
+  const Status insertEntry(const char* key, const RID & rid);
+  const Status deleteEntry(const char* key, const RID & rid);
+
+  bool supports(const Operator op) const { return op != NE; }
+
+  // everything but NE, which is BADSCANPARM
+  const Status startScan(const char* filter, const Operator op);
+  // the entries from low to high, either of which may be NULL for no
+  // bound, in key order
+  const Status startScan(const char* low, const bool lowIncl,
+			 const char* high, const bool highIncl);
+  const Status scanNext(RID & rid);
+  const Status endScan();
+
+  const int getNumEntries() const;
+  const int getHeight() const;
+
+private:
+  File*		file;
+  BTreeHdr*	hdr;		// pinned header page
+  int		hdrPageNo;
+  bool		hdrDirty;
+  int		leafLen;	// bytes of a leaf entry
+  int		innerLen;	// and of an inner entry
+  int		leafCap;	// entries a leaf holds
+  int		innerCap;
+
+  // state of a scan: the bounds, the matches collected from the
+  // current leaf and the entry after which the next leaf starts
+  bool		scanning;
+  bool		hasLow, lowIncl, hasHigh, highIncl;
+  vector<char>	low, high, last;
+  bool		scanDone;
+  vector<RID>	matches;
+  unsigned	nextMatch;
+
+  char*		entry(BTNode* node, const int i) const;
+  int		compareEntry(const char* a, const char* b) const;
+  int		search(BTNode* node, const char* probe, const bool upper) const;
+  int		childOf(BTNode* node, const int i) const;
+  const Status	insertAt(const int pageNo, const char* probe, bool & split,
+			 char* sep, int & newPageNo);
+  const Status	findLeaf(const char* probe, int & pageNo, Page*& page);
+  const Status	fillMatches();
+};
+
+#endif
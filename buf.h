@@ -1,6 +1,14 @@
 #ifndef BUF_H
 #define BUF_H
 
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include "db.h"
 // define if debug output wanted
 //#define DEBUGBUF
@@ -8,24 +16,47 @@
 // declarations for buffer pool hash table
 struct hashBucket
 {
-	File*	file;    // pointer a file object (more on this below)
+	File*	file;    // pointer a file object (NULL if slot is empty)
 	int	pageNo;  // page number within a file
 	int	frameNo; // frame number of page in the buffer pool
-	hashBucket* 	next;	 // next node in the hash table
 };
 
 
-// hash table to keep track of pages in the buffer pool
+// hash table to keep track of pages in the buffer pool.  The table is
+// a flat array of buckets using open addressing with Robin Hood
+// linear probing, so inserts and removes never allocate and a lookup
+// touches one or two adjacent cache lines.
+//
+// For concurrent use the table is split into NUMHASHPARTS partitions,
+// each a separate probe region with its own latch.  insert, lookup and
+// remove do no locking themselves: the caller must hold the latch of
+// partition(file, pageNo) around each call.
+const int NUMHASHPARTS = 16;
+
 class BufHashTbl
 {
 private:
-    int HTSIZE;
-    hashBucket**  ht; // actual hash table
-    int	 hash(const File* file, const int pageNo); // returns value between 0 and HTSIZE-1
+    struct alignas(64) partLatch { std::mutex latch; };
+
+    int HTSIZE;            // number of slots in each partition, a power of two
+    int mask;              // HTSIZE - 1
+    int numEntries[NUMHASHPARTS]; // number of slots in use per partition
+    hashBucket*  ht; // actual hash table, NUMHASHPARTS * HTSIZE slots
+    partLatch*  latches;   // one latch per partition
+    uint64_t hash(const File* file, const int pageNo); // mixes the key
+    int  probeDist(const int part, const int index); // distance of entry from its home slot
 
 public:
     BufHashTbl(const int htSize);  // constructor
     ~BufHashTbl(); // destructor
+
+    // partition holding (file,pageNo), and its latch
+    int  partition(const File* file, const int pageNo)
+    {
+      return (int)(hash(file, pageNo) >> 60) & (NUMHASHPARTS - 1);
+    }
+    void lock(const int part) { latches[part].latch.lock(); }
+    void unlock(const int part) { latches[part].latch.unlock(); }
 	
     // insert entry into hash table mapping (file,pageNo) to frameNo;
     // returns 0 if OK, HASHTBLERROR if an error occurred
@@ -43,91 +74,360 @@ public:
 
 
 class BufMgr;  //forward declaration of BufMgr class 
+class BufRing;
+
+// how the caller expects to use a page, passed to readPage
+enum BufHint {
+  BUF_RANDOM,      // no particular pattern; cache normally
+  BUF_SEQUENTIAL,  // part of a scan in page order
+  BUF_ONCE         // not expected to be referenced again soon
+};
 
-// class for maintaining information about buffer pool frames
+// class for maintaining information about buffer pool frames.
+//
+// The buffer manager may be used by several threads at once.  The tag
+// (file, pageNo, valid) of a frame only changes while the frame is
+// claimed (pinned by the thread changing it and by nobody else) and
+// the hash partition of the tag is latched, so a thread that finds a
+// page in the hash table and pins it under the partition latch can
+// rely on the frame holding that page until it unpins it.  pinCnt,
+// dirty and refbit are atomics updated without latches; file is atomic
+// so flushFile can look for its pages without claiming every frame.
+//
+// latch is the frame's shared/exclusive content latch.  Callers take
+// it through BufMgr::latchPage while the page is pinned; the buffer
+// manager holds it exclusively while a page is being read in, so a
+// reader that pins a page still in transit waits on it.
 class BufDesc {
     friend class BufMgr;
+    friend class BufReplacer;
 private:
-  File* file;   // pointer to file object
+  std::atomic<File*> file; // pointer to file object
   int   pageNo; // page within file
   int	frameNo;  // frame # of frame
-  int   pinCnt; // number of times this page has been pinned
-  bool 	dirty;	  // true if dirty;  false otherwise
-  bool 	valid;   // true if page is valid
-  bool  refbit;	 // has this buffer frame been reference recently
+  std::atomic<int>  pinCnt; // number of times this page has been pinned
+  std::atomic<int>  userPins; // of those, pins by readPage and allocPage
+                              // callers rather than the pool's own claims
+  std::atomic<bool> dirty;  // true if dirty;  false otherwise
+  std::atomic<bool> valid;  // true if page is valid
+  std::atomic<bool> refbit; // has this buffer frame been reference recently
+  std::atomic<bool> ioPending; // page is still being read in
+  std::atomic<BufRing*> ring;  // scan ring that loaded the page, NULL if shared
+  std::atomic<LSN> lsn;     // last logged change since the page was read
+  int	fileNext;  // next/previous frame holding a page of the same file,
+  int	filePrev;  // -1 at the ends; under BufMgr's file latch
+  std::shared_mutex latch;  // content latch
 
   void Clear() {  // initialize buffer frame for a new user
-    	pinCnt = 0;
 	file = NULL;
 	pageNo = -1;
     	dirty = false;
 	valid = false;
+	ring = NULL;
+	lsn = 0;
   };
 
+  // the pin count is left alone: the frame is already claimed by
+  // the caller
   void Set(File* filePtr, int pageNum) { 
       file = filePtr;
       pageNo = pageNum;
-      pinCnt = 1;
       dirty = false;
       valid = true;
       refbit = true;
+      ring = NULL;
+      lsn = 0;
   }
 
   BufDesc() {
+      fileNext = filePrev = -1;
+      pinCnt = 0;
+      userPins = 0;
+      refbit = false;
+      ioPending = false;
       Clear();
   }
 };
 
 
+// Counters of the buffer pool, which threads bump as they go.  A copy
+// is a snapshot of them at one moment.
 struct BufStats
 {
-  int accesses;    // Total number of accesses to buffer pool
-  int diskreads;   // Number of pages read from disk (including allocs)
-  int diskwrites;  // Number of pages written back to disk
+  std::atomic<uint64_t> accesses;    // readPage and allocPage calls
+  std::atomic<uint64_t> diskreads;   // Number of pages read from disk (including allocs)
+  std::atomic<uint64_t> diskwrites;  // Number of pages written back to disk
+  std::atomic<uint64_t> bgwrites;    // of those, pages the background writer wrote
+  std::atomic<uint64_t> hits;        // readPage calls satisfied from the pool
+                                     // or, for mapped files, in place
+  std::atomic<uint64_t> misses;      // readPage calls that had to go to disk
+  std::atomic<uint64_t> evictions;   // pages dropped to make room for others
+  std::atomic<uint64_t> dirtyEvictions; // of those, pages written back first
+  std::atomic<uint64_t> pinWaits;    // pins that waited for another thread's read
+  std::atomic<uint64_t> bufExceeded; // frames wanted when every one was pinned
+  std::atomic<uint64_t> refClears;   // referenced bits the clock cleared
 
   void clear()
     {
-      accesses = diskreads = diskwrites = 0;
+      accesses = diskreads = diskwrites = bgwrites = hits = misses = 0;
+      evictions = dirtyEvictions = pinWaits = bufExceeded = refClears = 0;
     }
       
   BufStats()
     {
       clear();
     }
+
+  BufStats(const BufStats & other)
+    {
+      *this = other;
+    }
+
+  BufStats & operator=(const BufStats & other)
+    {
+      accesses = other.accesses.load();
+      diskreads = other.diskreads.load();
+      diskwrites = other.diskwrites.load();
+      bgwrites = other.bgwrites.load();
+      hits = other.hits.load();
+      misses = other.misses.load();
+      evictions = other.evictions.load();
+      dirtyEvictions = other.dirtyEvictions.load();
+      pinWaits = other.pinWaits.load();
+      bufExceeded = other.bufExceeded.load();
+      refClears = other.refClears.load();
+      return *this;
+    }
 };
 
 
+// most pages brought in by one read-ahead
+const int MAXREADAHEAD = 64;
+
+// most dirty victims a miss passes over, leaving them to the
+// background writer, before it writes one back itself
+const int MAXDIRTYSKIPS = 8;
+
+// buffer replacement policies selectable when the BufMgr is built
+enum BufPolicy { CLOCK, LRUK, TWOQ, ARC };
+
+
+// Interface of a buffer replacement policy.  The BufMgr reports every
+// reference to a resident page and every frame it empties; the policy
+// chooses which frame to reuse on a miss.  A policy never picks a
+// frame that is pinned, but the choice is only a candidate: the BufMgr
+// claims the frame itself and asks again if another thread got there
+// first.
+//
+// Calls are serialized by the BufMgr's policy latch unless latchFree()
+// is true, in which case the policy must cope with concurrent calls.
+class BufReplacer
+{
+public:
+  BufReplacer(BufDesc* table, const int bufs, BufStats& stats)
+    : bufTable(table), numBufs(bufs), bufStats(stats) {}
+  virtual ~BufReplacer() {}
+
+  virtual const char* name() const = 0;
+  virtual bool latchFree() const { return false; }
+
+  // frame the policy will look at first for its next victim; the
+  // background writer cleans frames from here on
+  virtual int sweepStart() const { return 0; }
+
+  // page (file,pageNo) in frame was referenced; miss is true if it
+  // was just brought into the frame.  Pages referenced with BUF_ONCE
+  // are not promoted and are among the first to be replaced.
+  virtual void access(const int frame, const File* file,
+		      const int pageNo, const bool miss,
+		      const BufHint hint) = 0;
+
+  // choose a frame to hold (file,pageNo); returns BUFFEREXCEEDED if
+  // every frame is pinned.  The frame is not changed until evicted()
+  virtual const Status pickVictim(const File* file, const int pageNo,
+				  int& frame) = 0;
+
+  // page in frame (still described by its BufDesc) is being replaced
+  virtual void evicted(const int frame) = 0;
+
+  // frame was emptied without being replaced (dispose, flushFile,
+  // failed read)
+  virtual void released(const int frame) = 0;
+
+protected:
+  BufDesc*  bufTable;   // frame descriptors of the pool
+  int	    numBufs;    // number of frames in the pool
+  BufStats& bufStats;   // statistics of the owning BufMgr
+
+  bool frameValid(const int frame) const { return bufTable[frame].valid; }
+  bool framePinned(const int frame) const { return bufTable[frame].pinCnt > 0; }
+  std::atomic<bool>& frameRefbit(const int frame) { return bufTable[frame].refbit; }
+  const File* frameFile(const int frame) const { return bufTable[frame].file; }
+  int framePageNo(const int frame) const { return bufTable[frame].pageNo; }
+};
+
+
+// A small private set of frames that a large sequential scan cycles
+// through.  A page read through the ring is loaded into the ring's
+// next frame, replacing the page the scan read there earlier, so the
+// scan never evicts more than the ring's worth of the shared pool.
+// A page another reader hits while it is resident leaves the ring.
+class BufRing
+{
+  friend class BufMgr;
+private:
+  int	size;      // number of slots
+  int	next;      // slot to be reused next
+  int*	frames;    // frame held by each slot, -1 if none yet
+
+  BufRing(const int ringSize);
+  ~BufRing();
+};
+
+
+// The buffer manager.  All public methods may be called from several
+// threads at once.  Lookups and pins of resident pages only take the
+// latch of one hash partition; a miss claims a victim frame with a
+// compare-and-swap on its pin count and does its disk I/O holding no
+// latch but the frame's own.
 class BufMgr 
 {
 private:
-  unsigned int 	 clockHand;
   int   	 numBufs;    	// Number of pages in buffer pool
   BufHashTbl*    hashTable;  	// hash table mapping (File, page) to frame
   BufDesc*	 bufTable;  	// vector of status info, 1 per page
   BufStats	 bufStats;	// buffer pool statistics
+  BufReplacer*	 replacer;	// replacement policy
+  std::mutex	 policyLatch;	// serializes calls into the replacer
+  int		 readAhead;	// pages read ahead of a sequential miss
+  size_t	 poolBytes;	// size of the region bufPool is mapped in
+
+  // background writer
+  std::thread	 writer;
+  std::atomic<bool> writerActive; // writer thread is running
+  bool		 writerStop;	// asks the writer to exit
+  int		 writerInterval; // ms between rounds
+  int		 writerBatch;	// most pages written per round
+  std::mutex	 writerLatch;	// protects writerStop
+  std::condition_variable writerWake; // wakes the writer early
+  std::mutex	 flushLatch;	// held by a writer round and by flushFile
+  vector<const File*> flushQueue; // files queued by flushFileAsync
 
-  const Status allocBuf(int & frame);   // allocate a free frame.  
+  // frames holding pages of each file, linked through the BufDesc
+  unordered_map<const File*, int> fileFrames;
+  std::mutex	 fileLatch;	// protects fileFrames and the links
+
+  // allocate a frame to hold (file,pageNo); the frame is returned
+  // claimed, empty and not in the hash table
+  const Status allocBuf(const File* file, const int pageNo, int & frame);
   const void releaseBuf(int frame); // return unused frame to end of list
-  void advanceClock()
+  // allocate a frame for (file,pageNo) from a scan ring
+  const Status allocRingBuf(BufRing* ring, const File* file,
+			    const int pageNo, int & frame);
+  // claim a frame the policy picks for (file,pageNo)
+  const Status claimVictim(const File* file, const int pageNo, int & frame);
+  // pin an unpinned frame for exclusive use, false if it is in use
+  bool  claimFrame(const int frame)
   {
-	clockHand = (clockHand + 1) % numBufs;
+	int unpinned = 0;
+	return bufTable[frame].pinCnt.compare_exchange_strong(unpinned, 1);
   }
+  // write back and unmap the page in a claimed frame; evicted is
+  // false if another thread started using the page meanwhile.  The
+  // policy is told the page was replaced, or only released
+  const Status evictFrame(const int frame, const bool replaced,
+			  bool & evicted);
+  // count the eviction of the page a claimed frame held, if valid
+  void  countEviction(const bool valid, const bool dirty);
+  // true if (file,pageNo) is resident
+  bool  isResident(const File* file, const int pageNo);
+  // map (file,pageNo) to a claimed empty frame; installed is false if
+  // another thread mapped the page first.  A full hash table releases
+  // the frame and is returned
+  const Status installPage(File* file, const int pageNo, const int frame,
+			   BufRing* ring, const bool ioPending,
+			   bool & installed);
+  // pin the resident page (file,pageNo), waiting for its read to
+  // finish; HASHNOTFOUND if it is not resident
+  const Status pinResident(File* file, const int pageNo, int & frame,
+			   const BufHint hint, BufRing* ring);
+  // the replacement policy, under the policy latch when needed
+  void  policyAccess(const int frame, const File* file, const int pageNo,
+		     const bool miss, const BufHint hint);
+  void  policyEvicted(const int frame);
+  void  policyReleased(const int frame);
+  // add a frame that was just mapped to its file's list, or take a
+  // frame that was just unmapped off it
+  void  linkFrame(const int frame);
+  void  unlinkFrame(const int frame);
+  // frames holding pages of file; the list can change as soon as it
+  // is returned, so each frame must be checked once claimed
+  void  framesOf(const File* file, vector<int> & frames);
+  // write the dirty, unpinned pages of file without dropping them
+  const Status writeFile(const File* file);
+  // write the dirty pages in frames, sorted and coalesced into runs
+  // of consecutive pages; the frames must be claimed or the pool idle
+  const Status writeFrames(std::vector<int> & frames);
+  // one round of the background writer: clean up to maxPages dirty,
+  // unpinned frames, starting where the policy looks next
+  const Status writeAhead(const int maxPages);
+  void  writerLoop();
+  // read a run of non-resident pages into frames with one I/O
+  const Status loadRun(File* file, const int pageNo, const int numPages,
+		       const BufHint hint, BufRing* ring, const bool pinFirst,
+		       int & firstFrame);
 
 
 public:
   Page*	         bufPool;   // actual buffer pool
 
-  BufMgr(const int bufs);
+  // hugePages backs the pool with 2MB pages where the system has them
+  BufMgr(const int bufs, const BufPolicy policy = CLOCK,
+	 const bool hugePages = false);
   ~BufMgr();
 
-  const Status readPage(File* file, const int PageNo, Page*& page);
+  // A page of a mapped file is not copied into the pool: page points
+  // into the mapping, and pins and unpins only keep count.
+  const Status readPage(File* file, const int PageNo, Page*& page,
+			const BufHint hint = BUF_RANDOM,
+			BufRing* ring = NULL);
   const Status unPinPage(File* file, const int PageNo, const bool dirty);
   const Status allocPage(File* file, int& PageNo, Page*& page); 
                         // allocates a new, empty page 
   const Status flushFile(const File* file); // writing out all dirty pages of the file
+  // Queue the file's dirty pages to be written by the background
+  // writer and return at once; the pages stay resident.  Without a
+  // writer the pages are written before returning.
+  const Status flushFileAsync(const File* file);
   const Status disposePage(File* file, const int PageNo); // dispose of page in file
+
+  // bring pages pageNo..pageNo+numPages-1 into the pool without
+  // pinning them; pages already resident are skipped
+  const Status prefetch(File* file, const int pageNo, const int numPages);
+  // number of pages read ahead when a BUF_SEQUENTIAL read misses
+  void  setReadAhead(const int pages);
+
+  // Start a thread that writes dirty, unpinned pages back every
+  // intervalMs milliseconds, at most batch pages a round (0 picks an
+  // eighth of the pool), so that misses rarely have to write a victim
+  // themselves.  The writer is stopped by stopWriter() or ~BufMgr.
+  void  startWriter(const int intervalMs = 100, const int batch = 0);
+  void  stopWriter();
   void  printSelf();
 
+  // Give a pinned page, latched exclusively, the LSN of the log record
+  // of the change just made to it.  The log is forced that far before
+  // the page is written back.
+  void  setPageLSN(Page* page, const LSN lsn);
+
+  // shared (reading) or exclusive (updating) latch on a pinned page
+  void  latchPage(const Page* page, const bool exclusive);
+  void  unlatchPage(const Page* page, const bool exclusive);
+
+  BufRing* newRing(const int size);  // ring of frames for a large scan
+  void  freeRing(BufRing* ring);     // return the ring's frames to the pool
+  const int getNumBufs() const { return numBufs; }
+
   const BufStats & getBufStats() const // get buffer pool usage
   {
 	return bufStats;
@@ -136,6 +436,45 @@ public:
   {
 	bufStats.clear();
   }
+  // write the counters and the state of the frames in the Prometheus
+  // text format
+  void writeMetrics(ostream & out);
+  const char* getPolicyName() const // name of the replacement policy
+  {
+	return replacer->name();
+  }
+};
+
+
+// A pin on a page of the buffer pool that is dropped when the handle
+// goes away, is moved from, or is pinned to another page, so every
+// return path unpins.  Handles move but do not copy.
+class PageHandle
+{
+private:
+  File*	file;
+  int	pageNo;
+  Page*	page;		// NULL if no page is held
+  bool	dirty;
+
+  PageHandle(const PageHandle&) = delete;
+  PageHandle& operator=(const PageHandle&) = delete;
+
+public:
+  PageHandle() : file(NULL), pageNo(-1), page(NULL), dirty(false) {}
+  PageHandle(PageHandle&& other);
+  PageHandle& operator=(PageHandle&& other);
+  ~PageHandle() { release(); }
+
+  // pin page pageNo of file through bufMgr, releasing any page held
+  const Status pin(File* file, const int pageNo,
+		   const BufHint hint = BUF_RANDOM);
+  const Status release();	// unpin the page held, if any
+
+  void	markDirty() { dirty = true; }
+  Page*	get() const { return page; }
+  int	getPageNo() const { return pageNo; }
+  bool	valid() const { return page != NULL; }
 };
 
 #endif
@@ -0,0 +1,188 @@
+#ifndef BUFPOLICY_H
+#define BUFPOLICY_H
+
+#include <list>
+#include <unordered_map>
+#include "buf.h"
+
+// Replacement policies for the buffer manager.  CLOCK is the default;
+// LRU-K, 2Q and ARC are scan resistant: a page referenced once by a
+// sequential scan is evicted ahead of pages referenced repeatedly.
+
+// returns a new replacer of the given kind for a pool of bufs frames
+BufReplacer* newReplacer(const BufPolicy policy, BufDesc* table,
+			 const int bufs, BufStats& stats);
+
+
+// identity of a disk page, used by policies that remember pages
+// after they have left the pool
+struct PageId
+{
+  uint64_t fileId;	// File::getId(), as File objects are reused
+  int	pageNo;
+
+  bool operator == (const PageId& other) const
+    {
+      return fileId == other.fileId && pageNo == other.pageNo;
+    }
+};
+
+struct PageIdHash
+{
+  size_t operator () (const PageId& id) const
+    {
+      return hash<uint64_t>()(id.fileId) ^ ((size_t)id.pageNo * 0x9e3779b97f4a7c15ULL);
+    }
+};
+
+
+// Doubly linked lists of frames threaded through per-frame link
+// arrays.  A frame is on at most one of the lists at any time; the
+// head of a list is its LRU end and the tail its MRU end.
+class FrameLists
+{
+private:
+  int* prev;
+  int* next;
+  int* owner;       // list the frame is on, -1 if none
+  int* head;
+  int* tail;
+  int* count;
+
+public:
+  FrameLists(const int numFrames, const int numLists);
+  ~FrameLists();
+
+  void append(const int list, const int frame); // add frame at MRU end
+  void remove(const int frame);                 // take frame off its list
+  int listOf(const int frame) const { return owner[frame]; }
+  int first(const int list) const { return head[list]; }  // -1 if empty
+  int after(const int frame) const { return next[frame]; } // -1 at end
+  int size(const int list) const { return count[list]; }
+};
+
+
+// Bounded LRU list of pages that have been evicted, each carrying a
+// policy specific value.
+class GhostList
+{
+private:
+  typedef list<pair<PageId, unsigned long> > Order;
+  Order order;                  // front is the LRU end
+  unordered_map<PageId, Order::iterator, PageIdHash> index;
+
+public:
+  bool find(const PageId& id, unsigned long& value) const;
+  bool contains(const PageId& id) const { return index.count(id) != 0; }
+  void insert(const PageId& id, const unsigned long value);
+  void erase(const PageId& id);
+  void popLRU();
+  int size() const { return (int) index.size(); }
+};
+
+
+// The clock algorithm: sweep the frames, giving each referenced frame
+// a second chance by clearing its refbit.  The hand and the refbits
+// are atomics, so the clock needs no latch: concurrent sweeps just
+// take turns moving the hand.
+class ClockReplacer : public BufReplacer
+{
+private:
+  std::atomic<unsigned int> clockHand;
+
+  // move the hand to the next frame and return it
+  int advanceClock()
+  {
+	return (clockHand.fetch_add(1) + 1) % numBufs;
+  }
+
+public:
+  ClockReplacer(BufDesc* table, const int bufs, BufStats& stats);
+
+  const char* name() const { return "clock"; }
+  bool latchFree() const { return true; }
+  int sweepStart() const { return (clockHand + 1) % numBufs; }
+  void access(const int frame, const File* file, const int pageNo,
+	      const bool miss, const BufHint hint);
+  const Status pickVictim(const File* file, const int pageNo, int& frame);
+  void evicted(const int frame) {}
+  void released(const int frame) {}
+};
+
+
+// LRU-2: evict the page whose second most recent reference is oldest.
+// Pages seen only once have an infinite backward distance and go
+// first, in LRU order.  Reference times of evicted pages are kept for
+// a while so a page that returns quickly keeps its history.
+class LRUKReplacer : public BufReplacer
+{
+private:
+  unsigned long clock;     // logical time, one tick per reference
+  unsigned long* last;     // time of most recent reference per frame
+  unsigned long* prior;    // time of the reference before that, 0 if none
+  GhostList history;       // last reference time of evicted pages
+
+public:
+  LRUKReplacer(BufDesc* table, const int bufs, BufStats& stats);
+  ~LRUKReplacer();
+
+  const char* name() const { return "lru-k"; }
+  void access(const int frame, const File* file, const int pageNo,
+	      const bool miss, const BufHint hint);
+  const Status pickVictim(const File* file, const int pageNo, int& frame);
+  void evicted(const int frame);
+  void released(const int frame);
+};
+
+
+// 2Q (Johnson & Shasha): new pages enter a small FIFO (A1in) and are
+// promoted to the main LRU (Am) only if they are referenced again
+// after leaving it, which the A1out ghost list detects.
+class TwoQReplacer : public BufReplacer
+{
+private:
+  enum { FREE, A1IN, AM };
+  FrameLists lists;
+  GhostList a1out;
+  int kin;                 // target size of A1in
+  int kout;                // size of A1out
+
+  int unpinnedIn(const int list) const; // LRU unpinned frame on list
+
+public:
+  TwoQReplacer(BufDesc* table, const int bufs, BufStats& stats);
+
+  const char* name() const { return "2q"; }
+  void access(const int frame, const File* file, const int pageNo,
+	      const bool miss, const BufHint hint);
+  const Status pickVictim(const File* file, const int pageNo, int& frame);
+  void evicted(const int frame);
+  void released(const int frame);
+};
+
+
+// ARC (Megiddo & Modha): resident pages seen once (T1) and more than
+// once (T2), with ghost lists B1/B2 of pages recently evicted from
+// each.  Hits in the ghost lists move the target size p of T1.
+class ARCReplacer : public BufReplacer
+{
+private:
+  enum { FREE, T1, T2 };
+  FrameLists lists;
+  GhostList b1, b2;
+  int p;                   // target size of T1
+
+  int unpinnedIn(const int list) const; // LRU unpinned frame on list
+
+public:
+  ARCReplacer(BufDesc* table, const int bufs, BufStats& stats);
+
+  const char* name() const { return "arc"; }
+  void access(const int frame, const File* file, const int pageNo,
+	      const bool miss, const BufHint hint);
+  const Status pickVictim(const File* file, const int pageNo, int& frame);
+  void evicted(const int frame);
+  void released(const int frame);
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+// A small LZ77 byte compressor in the style of LZ4, for pages.  The
+// input is a run of sequences, each a token byte whose high nibble is
+// a count of literals and low nibble a match length less MINMATCH,
+// either extended by bytes of 255 and a last byte when it is 15; then
+// the literals; then a 2-byte offset back to the match.  The last
+// sequence has literals only.  It is fast rather than tight, and
+// inputs must be under 64K.
+
+// Compress srcLen bytes into at most dstCap bytes, returning the bytes
+// used, or -1 if they do not fit.
+int lzCompress(const char* src, const int srcLen, char* dst, const int dstCap);
+
+// Decompress srcLen bytes into exactly dstLen bytes, returning dstLen,
+// or -1 if the input is not a valid compression of dstLen bytes.
+int lzDecompress(const char* src, const int srcLen, char* dst, const int dstLen);
+
+// FNV-1a hash, for checksums
+unsigned fnvHash(const char* data, const int length);
+
+#endif
@@ -2,8 +2,15 @@
 #define DB_H
 
 #include <sys/types.h>
+#include <atomic>
 #include <functional>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <vector>
 #include "error.h"
+#include "metrics.h"
+#include "slab.h"
 #include <string.h>
 using namespace std;
 
@@ -15,7 +22,48 @@ using namespace std;
 // forward class definition for db
 class DB;
 
-// class definition for open files
+// structure of DB (header) page
+
+typedef struct {
+  int nextFree;                         // page # of next page on free list
+  int firstPage;                        // page # of first page in file
+  int numPages;                         // total # of pages in file
+  int pageSize;                         // bytes per page, 0 in files made
+                                        // when pages were always 1K
+  int compressed;                       // 1 if pages are stored compressed
+} DBPage;
+
+// I/O of a file, counted as the reads and writes of its pages are made
+struct FileIOStats
+{
+  std::atomic<uint64_t> reads;          // pages read
+  std::atomic<uint64_t> writes;         // pages written
+  std::atomic<uint64_t> readBytes;      // bytes read of those pages
+  std::atomic<uint64_t> writeBytes;     // bytes written of those pages
+  LatencyHist readLatency;              // of each read call, vectored or not
+  LatencyHist writeLatency;             // of each write call
+
+  FileIOStats() { reads = writes = readBytes = writeBytes = 0; }
+};
+
+// a copy of the FileIOStats of a file at one moment
+struct FileIOSnapshot
+{
+  string fileName;
+  uint64_t reads;
+  uint64_t writes;
+  uint64_t readBytes;
+  uint64_t writeBytes;
+  LatencySnapshot readLatency;
+  LatencySnapshot writeLatency;
+
+  FileIOSnapshot() { reads = writes = readBytes = writeBytes = 0; }
+  void add(const FileIOSnapshot & other);
+};
+
+// class definition for open files.  Page I/O needs no locking; the
+// cached header and free list are protected by hdrLatch, so pages may
+// be allocated and disposed of from several threads at once.
 class File {
   friend class DB;
   friend class OpenFileHashTbl;
@@ -23,6 +71,9 @@ class File {
  public:
 
   Status allocatePage(int& pageNo);     // allocate a new page
+  // allocate numPages consecutive new pages at the end of the file,
+  // the first being pageNo, with one header update
+  Status allocatePages(const int numPages, int& pageNo);
   const Status disposePage(const int pageNo);       // release space for a page
   const Status readPage(const int pageNo,
 		  Page* pagePtr) const;       // read page from file
@@ -30,17 +81,82 @@ class File {
 		   const Page* pagePtr);      // write page to file
   const Status getFirstPage(int& pageNo) const;     // returns pageNo of first page
 
+  // Make pageNo a page in use, for recovery redoing a logged change
+  // to it: the file is extended to hold it, or it is taken off the
+  // free list, as its allocation may not have reached the disk.
+  const Status claimPage(const int pageNo);
+
+  // write the header back and wait until the file is on disk
+  const Status sync();
+
+  // read/write a run of numPages consecutive pages starting at pageNo
+  // with a single vectored system call; pagePtrs[i] holds page pageNo+i
+  const Status readPages(const int pageNo, const int numPages,
+		   Page* const pagePtrs[]) const;
+  const Status writePages(const int pageNo, const int numPages,
+		    const Page* const pagePtrs[]);
+
+  // tell the kernel a run of pages will be read soon, so it can
+  // start reading them in the background
+  const Status willNeed(const int pageNo, const int numPages) const;
+
+  // The DB header page is kept in memory while the file is open and
+  // written back on close, on flushHeader(), or after every
+  // checkpoint header updates (0 = only on close/flush).
+  const Status flushHeader();               // write header page to disk
+  void setHeaderCheckpoint(const int updates) { hdrCheckpoint = updates; }
+
+  // File space is reserved in extents of extentSize pages so that
+  // growing the file does not cost a write per page.
+  const Status preallocate(const int numPages); // reserve numPages more pages
+  void setExtentSize(const int pages) { extentSize = pages > 0 ? pages : 1; }
+  const int getNumPages() const { return header.numPages; }
+
+  // A mapped file is opened read-only and mapped into memory whole.
+  // Its pages are read in place, through mappedPage, and any attempt
+  // to change the file fails with FILEREADONLY.
+  bool isMapped() const { return map != NULL; }
+  // page pageNo in the mapping; NULL if it is not a page of the file
+  Page* mappedPage(const int pageNo) const;
+  // tell the kernel whether the mapping is being read in page order
+  void adviseMapped(const bool sequential);
+  // pins of mapped pages are only counted; PAGENOTPINNED if none
+  void pinMapped() { mapPins++; }
+  const Status unpinMapped();
+
+  // A compressed file stores each page that shrinks enough as a
+  // compressed image at the start of its place in the file and punches
+  // a hole over the rest, so what the file takes on disk, and what is
+  // read of it, shrinks when a page spans several file system blocks.
+  // Pages are compressed on every write and expanded on every read.
+  // A file asked to be compressed is made plain if its pages are no
+  // bigger than a block, since no page could then be shrunk.
+  bool isCompressed() const { return header.compressed != 0; }
+
+  // the I/O of the file since it was opened
+  void ioSnapshot(FileIOSnapshot & snap) const;
+
+  // a number no other File object is given, for keying what is
+  // remembered of a file past its last close; the object itself may
+  // be reused for another file
+  uint64_t getId() const { return id; }
+
   bool operator == (const File & other) const
     {
       return fileName == other.fileName;
     }
 
+  // A File is made on the first open of a file and freed on the last
+  // close, so they come from a slab rather than the allocator.
+  static void* operator new(size_t size);
+  static void operator delete(void* p);
+
  private: 
 
   File(const string &fname);                   // initialize
   ~File();                  // deallocate file object
 
-  static const Status create(const string &fileName);
+  static const Status create(const string &fileName, const bool compressed);
   static const Status destroy(const string &fileName);
 
   const Status open();
@@ -50,23 +166,52 @@ class File {
 		 Page* pagePtr) const;        // internal file read
   const Status intwrite(const int pageNo,
 		  const Page* pagePtr);       // internal file write
+  const Status intreadv(const int pageNo, const int numPages,
+		  Page* const pagePtrs[]) const;  // internal vectored read
+  const Status intwritev(const int pageNo, const int numPages,
+		   const Page* const pagePtrs[]); // internal vectored write
+  const Status packedRead(const int pageNo,
+		    Page* pagePtr) const;     // read of a compressed file
+  const Status packedWrite(const int pageNo,
+		     const Page* pagePtr);    // write of a compressed file
+  const Status extend(const int minPages);   // grow unix file to minPages
+  const Status headerChanged();              // note a header update
+  const Status writeHeader();                // flushHeader, latch held
 
 #ifdef DEBUGFREE
   void listFree();                      // list free pages
 #endif
 
   string fileName;                    // The name of the file
+  uint64_t id;                        // see getId()
   int openCnt;                        // # times file has been opened
   int unixFile;                       // unix file stream for file
+  bool direct;                        // open with O_DIRECT if possible
+  bool mapped;                        // open read-only and mapped
+  char* map;                          // the mapping, NULL if not mapped
+  size_t mapLen;                      // bytes mapped
+  std::atomic<int> mapPins;           // pins of mapped pages
+  std::atomic<int> mapAdvice;         // madvise advice in force
+  int blockSize;                      // file system block size
+  int ioUnit;                         // compressed pages written in these
+
+  DBPage header;                      // cached copy of DB header page
+  bool hdrDirty;                      // true if header not yet written back
+  int hdrUpdates;                     // # header updates since write-back
+  int hdrCheckpoint;                  // write back after this many updates
+  int extentPages;                    // # pages physically in unix file
+  int extentSize;                     // # pages to grow the file by
+  std::mutex hdrLatch;                // protects header and extentPages
+  mutable FileIOStats ioStats;        // counted by the int* calls
 };
 
 class BufMgr;
 extern BufMgr* bufMgr;
 
-// declarations for hash table of open files
+// declarations for hash table of open files; a bucket is keyed by
+// the name its file object holds, so the name is not copied
 struct fileHashBucket
 {
-	string	fname;    // name of the file
         File*   file;    // pointer to file object
 	fileHashBucket* next;	 // next node in the hash table
 	
@@ -78,22 +223,29 @@ class OpenFileHashTbl
 private:
     int HTSIZE;
     fileHashBucket**  ht; // actual hash table
-    int	 hash(string fileName);  // returns value between 0 and HTSIZE-1
+    Slab<fileHashBucket> buckets; // where the buckets come from
+    int	 hash(string_view fileName);  // returns value between 0 and HTSIZE-1
 
 public:
     OpenFileHashTbl();
     ~OpenFileHashTbl(); // destructor
+
+    // names are taken as string_view, so looking up a char* or a
+    // string name copies nothing
 	
     // returns OK if no error occured, HASHTBLERROR if an error occurred
-    Status insert(const string fileName, File* file);
+    Status insert(string_view fileName, File* file);
 
     // see if fileName is already in hash table.  If so a pointer to the file
     // object is returned.
     // returns OK if found. else returns HASHNOTFOUND
-    Status find(const string fileName, File*& file);
+    Status find(string_view fileName, File*& file);
 
     // returns OK if fileName was found.  Else return HASHTBLERROR
-    Status erase(const string fileName);
+    Status erase(string_view fileName);
+
+    // call fn on every open file
+    void forEach(const function<void(File*)> & fn);
 };
 
 
@@ -106,20 +258,45 @@ class DB {
   const Status createFile(const string & fileName) ;  // create a new file
   const Status destroyFile(const string & fileName) ; // destroy a file, 
                                                            // release all space
-  const Status openFile(const string & fileName, File* & file);  // open a file
+  const Status openFile(string_view fileName, File* & file);  // open a file
   const Status closeFile(File* file);         // close a file
 
- private:
-  OpenFileHashTbl   openFiles;    // list of open files
-};
+  // If file is open just once, keep every file from being opened or
+  // closed until endSoleUse() and return true, so the one user of
+  // the file may restructure it.  Otherwise return false.
+  bool beginSoleUse(const File* file);
+  void endSoleUse();
 
+  // Files opened from now on bypass the kernel page cache (O_DIRECT)
+  // where the file system allows it.  Every page buffer must then be
+  // aligned, which Page and the buffer pool guarantee.
+  void setDirectIO(const bool on) { directIO = on; }
 
-// structure of DB (header) page
+  // Files opened from now on are opened read-only and mapped into
+  // memory, so the buffer manager reads their pages in place instead
+  // of copying them into the pool.  Files already open keep the mode
+  // they were opened in.
+  void setMapped(const bool on) { mapped = on; }
 
-typedef struct {
-  int nextFree;                         // page # of next page on free list
-  int firstPage;                        // page # of first page in file
-  int numPages;                         // total # of pages in file
-} DBPage;
+  // Files created from now on store their pages compressed, where
+  // the pages span more than one file system block.  A compressed file cannot be mapped; it is opened as usual instead.
+  void setCompressed(const bool on) { compressed = on; }
+
+  // The I/O of every file opened since the DB was made, one entry per
+  // file name in name order; files still open are counted up to now.
+  void ioSnapshot(vector<FileIOSnapshot> & files);
+
+  // write ioSnapshot in the Prometheus text format
+  void writeMetrics(ostream & out);
+
+ private:
+  OpenFileHashTbl   openFiles;    // list of open files
+  bool		    directIO;     // open files with O_DIRECT
+  bool		    mapped;       // open files read-only and mapped
+  bool		    compressed;   // create files with compressed pages
+  std::mutex	    latch;        // protects openFiles and open counts
+  map<string, FileIOSnapshot> closedIO; // I/O of files since closed,
+					  // also under latch
+};
 
 #endif
@@ -0,0 +1,95 @@
+#ifndef HASHINDEX_H
+#define HASHINDEX_H
+
+#include "index.h"
+
+// bucket page numbers per directory page
+const int HASHDIRSIZE = PAGESIZE / sizeof(int);
+// directory pages the header can list
+const int HASHDIRPAGES = PAGESIZE / sizeof(int) - 9;
+
+// header page of a hash index file.  Bucket b's first page is found
+// in slot b % HASHDIRSIZE of directory page dirPages[b / HASHDIRSIZE].
+struct HashHdr
+{
+  int		offset;		// the attribute indexed
+  int		length;
+  Datatype	type;
+  int		numInit;	// buckets the index was created with
+  int		level;		// the table doubled this many times
+  int		next;		// next bucket to split
+  int		numBuckets;
+  int		numEntries;
+  int		numDirPages;
+  int		dirPages[HASHDIRPAGES];
+};
+
+// a page of a bucket: (key, RID) entries in no order, and the next
+// page of the bucket
+struct HashBucket
+{
+  int		numEntries;
+  int		overflow;	// next page of the bucket, -1 if last
+  char		entries[PAGESIZE - 2 * sizeof(int)];
+};
+
+static_assert(sizeof(HashHdr) <= PAGESIZE, "HashHdr must fit on a page");
+static_assert(sizeof(HashBucket) <= PAGESIZE, "HashBucket must fit on a page");
+
+// a bucket is split once the index is this many percent full
+const int HASHFILLPCT = 75;
+
+// A linear hashing index over a heap file attribute, for equality
+// lookups: a lookup reads a directory page and the pages of one
+// bucket.  Whenever the entries outgrow HASHFILLPCT of the buckets'
+// first pages, the next bucket in turn is split in two, so the table
+// grows a bucket at a time without rehashing the rest.  Full buckets
+// grow chains of overflow pages.  As with BTreeIndex the index is
+// latched as a whole through its header page.
+class HashIndex : public Index
+{
+public:
+  HashIndex(const IndexDesc & desc, Status & status);
+  ~HashIndex();
+
+  // create the index file desc names and load it with the records of
+  // the scan, which must have been started unfiltered, sized so the
+  // buckets start out HASHFILLPCT full
+  static const Status build(const IndexDesc & desc, HeapFileScan & scan);
+
+  const Status insertEntry(const char* key, const RID & rid);
+  const Status deleteEntry(const char* key, const RID & rid);
+
+  bool supports(const Operator op) const { return op == EQ; }
+
+  // EQ only; any other op is BADSCANPARM
+  const Status startScan(const char* filter, const Operator op);
+  const Status scanNext(RID & rid);
+  const Status endScan();
+
+  const int getNumEntries() const;
+  const int getNumBuckets() const;
+
+private:
+  File*		file;
+  HashHdr*	hdr;		// pinned header page
+  int		hdrPageNo;
+  bool		hdrDirty;
+  int		entryLen;	// bytes of an entry
+  int		bucketCap;	// entries a bucket page holds
+
+  bool		scanning;
+  vector<RID>	matches;
+  unsigned	nextMatch;
+
+  unsigned	hashKey(const char* key) const;
+  int		bucketOf(const char* key) const;
+  const Status	bucketPage(const int bucket, int & pageNo);
+  const Status	setBucketPage(const int bucket, const int pageNo);
+  const Status	newBucket(const int bucket, int & pageNo);
+  const Status	readBucket(int pageNo, vector<char> & ents);
+  const Status	writeBucket(int pageNo, const char* ents, const int n);
+  const Status	split();
+};
+
+#endif
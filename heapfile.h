@@ -4,12 +4,14 @@
 #include <sys/types.h>
 #include <functional>
 #include <iostream>
+#include <unordered_map>
 #include <vector>
 #include <string.h>
 using namespace std;
 
 #include "page.h"
 #include "buf.h"
+#include "log.h"
 
 extern DB db;
 
@@ -18,10 +20,80 @@ extern DB db;
 
 // Some constant definitions
 const unsigned MAXNAMESIZE = 50;
+const int SCANRINGSIZE = 16;   // frames in the buffer ring of a large scan
+const int BULKPAGES = 64;      // pages built and written at a time by a bulk load
 
 enum Datatype { STRING, INTEGER, FLOAT };    // attribute data types
 enum Operator { LT, LTE, EQ, GTE, GT, NE };  // scan operators
 
+// a scan predicate: true if the attribute at attr satisfies the filter
+typedef bool (*MatchFn)(const char* attr, const char* filter,
+			const int length);
+
+// one condition of a scan filter: the attribute of the given type,
+// length bytes at offset in the record, compared with *filter
+struct ScanPred
+{
+  int		offset;
+  int		length;
+  Datatype	type;
+  const char*	filter;
+  Operator	op;
+};
+
+// BADSCANPARM unless pred is a valid filter condition
+const Status checkScanPred(const ScanPred & pred);
+
+// an attribute returned by a projected scan
+struct ScanAttr
+{
+  int		offset;
+  int		length;
+};
+
+// kinds of secondary index; a zone map is registered like one
+enum IndexType { BTREE, HASH, ZONEMAP };
+
+// an index of the file, kept in its header: the index file and the
+// attribute it is keyed on
+const int MAXINDEXES = 4;
+struct IndexDesc
+{
+  char		name[MAXNAMESIZE];	// name of the index file
+  IndexType	kind;
+  int		offset;
+  int		length;
+  Datatype	type;
+};
+
+class Index;
+class ZoneMap;
+
+// an entry of the page directory: a data page and the bytes free
+// on it when they were last recorded, rounded down to FSMUNIT
+struct DirEntry
+{
+  int		pageNo;
+  int		freeSpace;
+};
+
+// The directory keeps the free space of a page in one byte, as a
+// count of FSMUNIT byte units, so the inserter can search free space
+// for the entries of a whole directory page at a time.
+const int FSMUNIT = (PAGESIZE + 255) / 256;
+
+// directory entries that fit in the header page after its other
+// fields, and in a directory page
+const int HDRDIRSIZE = (PAGESIZE - MAXNAMESIZE - 11 * sizeof(int)
+			- MAXINDEXES * sizeof(IndexDesc))
+		       / (sizeof(int) + 1);
+const int DIRPAGESIZE = (PAGESIZE - sizeof(int)) / (sizeof(int) + 1);
+
+// The page directory lists the data pages of the file in chain
+// order, so page n can be found without walking the chain and the
+// inserter can find a page with room.  The first HDRDIRSIZE entries
+// are kept in the header page, the rest in a chain of directory
+// pages from dirFirst.
 struct FileHdrPage
 {
   char		fileName[MAXNAMESIZE];   // name of file
@@ -29,10 +101,62 @@ struct FileHdrPage
   int		lastPage;	// pageNo of last data page in file
   int		pageCnt;	// number of pages
   int		recCnt;		// record count
+  int		dirCnt;		// directory entries, one per data page
+  int		dirFirst;	// first directory page, -1 if none
+  int		dirLast;	// last directory page, -1 if none
+  int		dirFreed;	// lowest entry whose page may have gained
+				// space from a delete; dirCnt if none
+  int		numIndexes;	// indexes kept up to date with the file
+  IndexDesc	indexes[MAXINDEXES];
+  int		dirPageNo[HDRDIRSIZE];	// data page of each entry
+  unsigned char	dirFree[HDRDIRSIZE];	// and its free space in FSMUNITs
+  int		paxRecLen;	// length of every record if the data pages
+				// are PAX pages; 0 for slotted pages
 };
 
+struct DirPage
+{
+  int		nextDir;	// next directory page, -1 if last
+  int		pageNo[DIRPAGESIZE];
+  unsigned char	freeMap[DIRPAGESIZE];
+};
+
+static_assert(sizeof(FileHdrPage) <= PAGESIZE, "FileHdrPage must fit on a page");
+static_assert(sizeof(DirPage) <= PAGESIZE, "DirPage must fit on a page");
 
-// class definition of heapFile
+
+// A record read in place.  The view keeps the page holding the record
+// pinned while it is alive, so records from several pages can be held
+// at once without copying them out.  The bytes stay where they are
+// until the record is deleted or an insert compacts its page.  Views
+// must be released before their file is closed.
+class RecordView
+{
+  friend class HeapFile;
+private:
+  PageHandle	handle;
+  Record	rec;
+  RID		rid;
+  vector<char>	copy;		// the record, if from a PAX page
+
+public:
+  RecordView() : rid(NULLRID) { rec.data = NULL; rec.length = 0; }
+
+  const Record& get() const { return rec; }
+  const char*	data() const { return (const char*) rec.data; }
+  int		length() const { return rec.length; }
+  const RID&	getRid() const { return rid; }
+  bool		valid() const { return handle.valid(); }
+  const Status	release() { return handle.release(); } // unpin the page
+};
+
+
+// class definition of heapFile.  A HeapFile object belongs to one
+// thread, but several threads may each open the same file: pages are
+// latched while they are read or changed, so any number of scans can
+// run alongside one InsertFileScan.  Two inserters on one file at a
+// time are not supported, since both would extend the same last page.
+// Latches are taken in the order data page, directory page, header.
 class HeapFile {
 protected:
    File* 	filePtr;        // underlying DB File object
@@ -44,10 +168,54 @@ protected:
    int   	curPageNo;	// page number of pinned page
    bool  	curDirtyFlag;   // true if page has been updated
    RID   	curRec;         // rid of last record returned
+   vector<char>	recBuf;		// a record of a PAX page, put together
+
+   // page directory access; the entries are latched while used
+   vector<int>	dirPages;	// directory pages, as far as looked up
+   unordered_map<int, int> dirIndex; // entry of each data page
+   int		dirIndexed;	// entries in dirIndex so far
+
+   // the page holding some directory entries, pinned, and its arrays
+   struct DirSlots {
+     int	pageNo;		// header or directory page
+     Page*	page;
+     int*	pageNos;
+     unsigned char* freeMap;
+     int	slot;		// index of the entry asked for
+     int	size;		// entries the page holds
+   };
+
+   const Status locateDirEntry(const int i, int& pageNo, int& slot);
+   const Status pinDir(const int i, DirSlots& dir);
+   const Status unpinDir(const DirSlots& dir, const bool dirty);
+   const Status getDirEntry(const int i, DirEntry& entry);
+   const Status setDirFree(const int i, const int freeSpace);
+   const Status appendDirEntry(const int pageNo, const int freeSpace);
+   const int findDirEntry(const int pageNo);
+   const Status noteFreeSpace(const int pageNo, const int freeSpace);
+   const Status removeDirEntry(const int i);
+   const Status rebuildDirectory();
+
+   // log a change just made to data page pageNo, which is latched
+   // exclusively, and give the page the record's LSN; nothing if
+   // there is no log.  page is NULL for a change to the header.
+   const Status logChange(Page* page, const LogType type, const int pageNo,
+			  const int arg, const void* data = NULL,
+			  const int length = 0);
+
+   // the file's indexes, opened when first needed
+   vector<Index*> indexes;
+   bool		indexesOpen;
+
+   const Status openIndexes();
+   // add or remove the entries of record rec at rid in every index
+   const Status indexRecord(const Record & rec, const RID & rid,
+			    const bool insert);
 
 public:
 
-  // initialize
+  // initialize.  A file opened mapped (see DB::setMapped) can only
+  // be read; inserts, deletes and index changes fail with FILEREADONLY.
   HeapFile(const string & name, Status& returnStatus);
 
   // destructor
@@ -56,8 +224,39 @@ public:
   // return number of records in file
   const int getRecCnt() const;
 
+  // return number of data pages in file
+  const int getPageCnt() const;
+
+  // page number of data page n of the file, counting from 0 in the
+  // order a scan visits them
+  const Status getPageNo(const int n, int& pageNo);
+
+  // Rebuild the directory, record count and last page of the header
+  // from the page chain, as after recovery.  Only the sole user of the
+  // file may call it.  The old directory pages are not reclaimed.
+  const Status repair();
+
+  // Record an index in, or drop it from, the header, so inserts and
+  // deletes keep it up to date.  HeapFile objects already open go on
+  // using the indexes they have.
+  const Status addIndex(const IndexDesc & desc);
+  const Status removeIndex(const string & name);
+
   // given a RID, read record from file, returning pointer and length
   const Status getRecord(const RID &rid, Record & rec);
+
+  // the same as a view, which stays valid however the file object
+  // moves on, until it is released or destroyed
+  const Status getRecord(const RID & rid, RecordView & view);
+
+  // Read the records of numRids RIDs at once, copying them into buf
+  // and pointing recs[i] at the copy of rids[i].  The RIDs are
+  // grouped by page so each page is pinned once, the pages missing
+  // from the pool are read ahead together, and the current page is
+  // left alone.  The records are copied so a batch may span more
+  // pages than the pool can hold.
+  const Status getRecords(const RID* rids, const int numRids,
+			  Record* recs, vector<char> & buf);
 };
 
 
@@ -70,34 +269,83 @@ public:
     // end filtered scan
     ~HeapFileScan();
 
+    // Start a scan from the beginning of the file.  A scan object can
+    // be started again for each new scan, keeping the file open.
     const Status startScan(const int offset, 
                            const int length,  
                            const Datatype type, 
                            const char* filter, 
                            const Operator op);
 
-    const Status endScan(); // terminate the scan
+    // scan for records that satisfy all of the numPreds predicates,
+    // or any of them if conjunctive is false.  The predicates are
+    // reordered as the scan runs so the ones most likely to decide a
+    // record are tested first.  If they must all hold and one is EQ
+    // on an attribute the file has an index of, only the records the
+    // index finds, as startScan runs, are tested, in page order.
+    // Otherwise, if they must all hold, pages a zone map shows cannot
+    // hold a match are passed over without being read.
+    const Status startScan(const ScanPred* preds,
+                           const int numPreds,
+                           const bool conjunctive = true);
+
+    // limit getProjection to the listed attributes; none means the
+    // whole record
+    const Status setProjection(const ScanAttr* attrs, const int numAttrs);
+
+    const Status endScan(); // terminate the scan, unpinning its page
     const Status markScan(); // save current position of scan
     const Status resetScan(); // reset scan to last marked location
 
     // return RID of next record that satisfies the scan 
     const Status scanNext(RID& outRid);
 
-    // read current record, returning pointer and length
+    // return the RIDs of the matching records on the next page of the
+    // scan that has any, in slot order.  The filter is evaluated over
+    // the whole page in one pass.  The page stays pinned until the
+    // scan moves on, so the records can be read with getRecord(rid).
+    const Status scanPage(vector<RID>& rids);
+
+    // the same for the given data page of the file, which becomes the
+    // current page
+    const Status scanPage(const int pageNo, vector<RID>& rids);
+
+    // read current record, returning pointer and length.  A record of
+    // a PAX file is a copy, good until the next record is read.
     const Status getRecord(Record & rec);
 
-    // delete current record 
+    // view of the current record, valid after the scan moves on
+    const Status getRecord(RecordView & view);
+    using HeapFile::getRecord;
+
+    // read a record on the current page, such as one returned by
+    // scanPage, without moving the scan.  BADRID if it is elsewhere.
+    const Status getRecord(const RID & rid, Record & rec);
+
+    // copy the projected attributes of a record on the current page
+    // to buf, packed in list order, and set length to the bytes copied
+    const Status getProjection(const RID & rid, char* buf, int & length);
+
+    // delete current record.  A page left empty, other than the last,
+    // is unlinked and disposed of when the scan moves off it, provided
+    // no other HeapFile has the file open.
     const Status deleteRecord();
 
     // marks current page of scan dirty
     const Status markDirty();
 
 private:
-    int   offset;            // byte offset of filter attribute
-    int   length;            // length of filter attribute
-    Datatype type;           // datatype of filter attribute
-    const char* filter;      // comparison value of filter
-    Operator op;             // comparison operator of filter
+    // a predicate of the filter, with the records it was tested on
+    // and passed since the predicates were last ordered
+    struct ScanTerm {
+      ScanPred pred;
+      MatchFn match;         // specialized for pred's type and op
+      unsigned evals;
+      unsigned passes;
+    };
+    vector<ScanTerm> terms;  // empty if no filtering requested
+    bool conjunctive;        // all terms must hold, else any one
+    vector<ScanAttr> projection;
 
      // The following variables are used to preserve the state
     // of the scan when the method markScan() is invoked.
@@ -106,7 +354,45 @@ private:
     int   markedPageNo;	// page number of pinned page
     RID   markedRec;         // rid of last record returned
 
-    const bool matchRec(const Record & rec) const;
+    // files larger than a quarter of the buffer pool are scanned
+    // through a private ring of frames so the scan does not flush
+    // the rest of the pool; NULL for smaller files
+    BufRing* ring;
+
+    // true once a record of the current page has been deleted; a page
+    // the scan leaves empty is given back to the file
+    bool curFreed;
+
+    // a scan answered by an index: the RIDs it returned, sorted, and
+    // the next one to visit
+    bool probing;
+    vector<RID> probeRids;
+    unsigned probeNext;
+    unsigned markedProbe;
+
+    // the terms a zone map of their attribute can rule pages out for
+    struct ZoneTerm {
+      ZoneMap* zone;
+      ScanPred pred;
+    };
+    vector<ZoneTerm> zoneTerms;
+
+    // scanNext on a PAX page hands out the matches matchPage found on
+    // it, one at a time
+    vector<RID> paxHits;
+    unsigned paxNext;
+    int paxPageNo;          // page of paxHits, -1 if none
+
+    const Status startProbe(const ScanPred* preds, const int numPreds);
+    const Status probePage(const RID & rid);
+    const Status skipPages(int & pageNo);
+    const Status leavePage();
+    const Status freePage();
+    const bool matchRec(const Record & rec);
+    const bool matchTerm(ScanTerm & term, const Record & rec);
+    void orderTerms();
+    const Status matchPage(vector<RID>& rids);
+    const Status matchPaxPage(vector<RID>& rids);
 };
 
 
@@ -119,8 +405,41 @@ public:
     // end filtered scan
     ~InsertFileScan();
 
-    // insert record into file, returning its RID
+    // insert record into file, returning its RID.  A record goes on
+    // the current page if it fits, else on a page the directory says
+    // has room, else on a new page at the end of the file.
     const Status insertRecord(const Record & rec, RID& outRid); 
+
+    // Bulk load: insert numRecs records, returning their RIDs in
+    // outRids unless it is NULL.  The current page is filled first;
+    // the rest are packed into new pages at the end of the file, which
+    // are allocated in one run and written straight to disk,
+    // BULKPAGES at a time, without going through the buffer pool.
+    // The header is updated once.
+    const Status insertRecords(const Record* recs, const int numRecs,
+			       RID* outRids);
+
+private:
+    const Status findFreePage(const int spaceNeeded, int& pageNo);
+    const Status addPage();
+    const Status linkPage(const int pageNo);
 };
 
+// Create a heap file of PAX pages, for records all recLen bytes long.
+// A filter on an INTEGER or FLOAT attribute at a multiple of 4 bytes
+// into the record is evaluated over a minipage of each page.
+const Status createPaxHeapFile(const string fileName, const int recLen);
+
+// Redo the changes in the log to the data pages of the heap files it
+// covers and repair their headers, after a crash.  No file may be open.
+// The log covers record inserts and deletes and the page chain; the
+// files' indexes are not logged and must be rebuilt.
+const Status recoverHeapFiles();
+
+// Write back and sync every file the log covers, then throw the log
+// away, so recovery has nothing left to replay.  Fails with
+// PAGEPINNED, leaving the log as it is, while one of the files is in
+// use; no other thread may change heap files meanwhile.
+const Status checkpointHeapFiles();
+
 #endif
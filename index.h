@@ -0,0 +1,70 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "heapfile.h"
+
+// A secondary index of a heap file: a file of its own holding a
+// (key, RID) entry for every record, where the key is the attribute
+// the IndexDesc names.  A record too short to hold the attribute has
+// no entry.  Entries are unique as (key, RID) pairs, so any number of
+// records may share a key.  An Index object belongs to one thread, as
+// a HeapFile does; the objects of several threads on one index file
+// share its latch.
+class Index
+{
+protected:
+  IndexDesc	desc;
+
+public:
+  Index(const IndexDesc & desc_) : desc(desc_) {}
+  virtual ~Index() {}
+
+  const IndexDesc& getDesc() const { return desc; }
+
+  // copy the key of rec to key; false if rec is too short to hold it
+  bool getKey(const Record & rec, char* key) const;
+
+  virtual const Status insertEntry(const char* key, const RID & rid) = 0;
+  // RECNOTFOUND if there is no such entry
+  virtual const Status deleteEntry(const char* key, const RID & rid) = 0;
+
+  // true if a scan with op can be answered by the index
+  virtual bool supports(const Operator op) const = 0;
+
+  // return the RIDs of the entries whose key op *filter holds, one
+  // per scanNext, until scanNext returns NOMORERECS
+  virtual const Status startScan(const char* filter, const Operator op) = 0;
+  virtual const Status scanNext(RID & rid) = 0;
+  virtual const Status endScan() = 0;
+};
+
+// <0, 0 or >0 as key a is less than, equal to or greater than key b,
+// compared as filters are: strings with strncmp over length bytes
+int compareKeys(const char* a, const char* b, const Datatype type,
+		const int length);
+
+// the same for (key, RID) entries, ordered by key and then by RID
+int compareEntries(const char* a, const char* b, const Datatype type,
+		   const int length);
+
+// append the (key, RID) entries of the records of the scan to ents,
+// for the bulk build of an index.  The scan must have been started
+// unfiltered.
+const Status collectEntries(const IndexDesc & desc, HeapFileScan & scan,
+			    vector<char> & ents);
+
+// open the index desc describes; NULL, with status set, if it fails
+Index* openIndex(const IndexDesc & desc, Status & status);
+
+// Build an index of the records of heap file heapName, named
+// indexName, on the attribute of the given type, length bytes at
+// offset, and record it in the heap file's header.  The file must not
+// be updated while the index is built.
+const Status createIndex(const string & heapName, const string & indexName,
+			 const IndexType kind, const int offset,
+			 const int length, const Datatype type);
+
+// drop the index from the heap file's header and destroy its file
+const Status destroyIndex(const string & heapName, const string & indexName);
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "page.h"
+
+using namespace std;
+
+// kinds of log record
+enum LogType {
+  LOG_INSERT,     // record data inserted at (pageNo, arg)
+  LOG_DELETE,     // record at (pageNo, arg) deleted
+  LOG_INITPAGE,   // data page pageNo initialized
+  LOG_LINKPAGE,   // next page of data page pageNo set to arg
+  LOG_FIRSTPAGE,  // first data page of the file set to arg
+  LOG_PAGEIMAGE,  // data page pageNo written whole, data holding it
+  LOG_CREATE      // the file was created; earlier records are of a
+		  // file of the same name since destroyed
+};
+
+// a log record as it is on disk, followed by the file name and then
+// the data
+struct LogRecHdr
+{
+  unsigned	checksum;	// of everything after this field
+  int		length;		// bytes of the record, this header included
+  LSN		lsn;		// position just past the record
+  LogType	type;
+  int		pageNo;
+  int		arg;		// slot, page number, or unused
+  int		nameLen;
+};
+
+// A write-ahead log of the changes made to heap file data pages.
+// Each change is logged while its page is latched, and the page is
+// given the record's LSN; the buffer manager forces the log as far
+// as a page's LSN before writing the page back, so pages can be
+// written back whenever it likes (steal) and need not be written at
+// commit (no force).
+//
+// Records are appended to an in-memory buffer.  commit makes the
+// calling thread's records durable.  Commits that arrive while the
+// log is being synced wait for the sync after it, which then covers
+// all of them, so concurrent committers share fsyncs.
+//
+// The LogMgr is used by several threads at once.
+class LogMgr
+{
+public:
+  // open, or create, the log file of the given name
+  LogMgr(const string & fileName, Status & status);
+  ~LogMgr();	// flushes the log and closes it
+
+  // append a record, returning its LSN
+  const Status log(const LogType type, const char* fileName,
+		   const int pageNo, const int arg, const void* data,
+		   const int length, LSN & lsn);
+
+  // make the log durable as far as lsn
+  const Status flush(const LSN lsn);
+
+  // make the records this thread has logged durable
+  const Status commit();
+
+  // Let a commit that will sync the log wait usecs microseconds
+  // first, so more commits can join it.  0, the default, never waits.
+  void setGroupDelay(const int usecs) { groupDelay = usecs; }
+
+  // Call fn on every record of the log, oldest first, stopping at the
+  // first that fails.  A torn record at the end is ignored.
+  const Status scan(function<Status(const LogRecHdr & rec, const char* name,
+				    const char* data)> fn);
+
+  // Throw the log away, once what is buffered is durable.  Every file
+  // it covers must have been written back and synced first, as
+  // checkpointHeapFiles does.
+  const Status truncate();
+
+  LSN getEndLSN();		// LSN after the last record
+  LSN getFlushedLSN();		// LSN up to which the log is durable
+  int getNumSyncs() const { return numSyncs; }
+
+private:
+  int		fd;
+  LSN		base;		// LSN of the first byte after the file header
+  LSN		endLSN;		// of the last record appended
+  LSN		flushedLSN;	// durable as far as this
+  vector<char>	buf;		// records appended and not yet written
+  LSN		bufStart;	// LSN at which buf starts
+  bool		syncing;	// a thread is writing and syncing
+  int		groupDelay;
+  int		numSyncs;
+  mutex		latch;		// protects all of the above
+  condition_variable synced;	// signalled when a sync finishes
+
+  const Status readHeader();
+  const Status writeHeader();
+};
+
+// the log of the database, NULL if changes are not logged
+extern LogMgr* logMgr;
+
+#endif
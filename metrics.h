@@ -0,0 +1,53 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <atomic>
+#include <ostream>
+#include <string>
+
+using namespace std;
+
+// Latencies are counted in buckets of powers of two microseconds:
+// bucket b holds those of at most 2^b us, the last one all the rest.
+const int LATBUCKETS = 24;
+
+// the counts of a LatencyHist at one moment
+struct LatencySnapshot
+{
+  uint64_t counts[LATBUCKETS];
+  uint64_t sumNs;
+
+  LatencySnapshot();
+  uint64_t count() const;
+  void add(const LatencySnapshot & other);
+};
+
+// A histogram of latencies, which several threads may record into at
+// once.
+class LatencyHist
+{
+public:
+  LatencyHist() { clear(); }
+  void record(const uint64_t ns);
+  void clear();
+  void snapshot(LatencySnapshot & snap) const;
+
+private:
+  std::atomic<uint64_t> counts[LATBUCKETS];
+  std::atomic<uint64_t> sumNs;
+};
+
+// nanoseconds on a clock that only goes forwards, for timing
+uint64_t monotonicNs();
+
+// Helpers for writing metrics in the Prometheus text format.  labels
+// is the inside of the braces, such as file="a", or empty.
+string metricLabel(const char* name, const string & value);
+void writeMetric(ostream & out, const char* name, const string & labels,
+		 const uint64_t value);
+// the _bucket, _sum and _count lines of a histogram in seconds
+void writeHistogram(ostream & out, const char* name, const string & labels,
+		    const LatencySnapshot & hist);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef PAGE_H
 #define PAGE_H
 
+#include <stddef.h>
 #include "error.h"
 #include "string.h"
 
@@ -11,6 +12,10 @@ struct RID{
 
 const RID NULLRID = {-1,-1};
 
+// log sequence number: the position in the write-ahead log just past
+// a log record.  0 is before every record.
+typedef long long LSN;
+
 struct Record
 {
   void* data;
@@ -23,40 +28,104 @@ struct slot_t {
         short	length;  // equals -1 if slot is not in use
 };
 
-const unsigned PAGESIZE = 1024;
-const unsigned DPFIXED= sizeof(slot_t)+4*sizeof(short)+2*sizeof(int);
+// Size of a page in bytes, chosen at build time (make PAGESIZE=8192).
+// A power of two from 1K to 16K: slot offsets are shorts.  Files
+// record the page size they were created with and can only be opened
+// by a build with the same size.
+#ifndef PAGESIZE_BYTES
+#define PAGESIZE_BYTES 4096
+#endif
+const unsigned PAGESIZE = PAGESIZE_BYTES;
+static_assert(PAGESIZE >= 1024 && PAGESIZE <= 16384
+	      && (PAGESIZE & (PAGESIZE - 1)) == 0,
+	      "PAGESIZE must be a power of two from 1024 to 16384");
+
+// Pages are aligned to their size, up to the 4K that O_DIRECT and
+// the VM page need, wherever they are allocated.
+const unsigned PAGEALIGN = PAGESIZE < 4096 ? PAGESIZE : 4096;
+
+// ends the chain of free slots; slot numbers are 0 or negative
+const short NOSLOT = 1;
+
+// in place of the free slot chain, marks a PAX page
+const short PAXPAGE = 2;
+
+const unsigned DPFIXED= sizeof(slot_t)+4*sizeof(short)+2*sizeof(int)+sizeof(LSN);
 const unsigned PAGEDATASIZE = PAGESIZE-DPFIXED+sizeof(slot_t);
 // size of the data area of a page
 
 // Class definition for a minirel data page.   
-// The design assumes that records are kept compacted when
-// deletions are performed. Notice, however, that the slot
-// array cannot be compacted.  Notice, this class does not keep
+//
+// A PAX page instead holds records of one length, recLen, in fixed
+// places 0 .. capacity-1, which are their slot numbers.  A record is
+// cut into 4-byte words; word w of every record on the page is kept
+// in minipage w, an array of capacity words, after a byte per place
+// saying whether a record is there.  A scan can then read one
+// attribute of all the records as a dense array.
+// A deleted record leaves a hole in data[] that is only compacted
+// away when an insert needs the space in one piece, and its slot
+// goes on a chain of free slots, linked through their offsets, that
+// inserts take from first.  Both make inserts and deletes constant
+// time.  Notice, however, that the slot array cannot be compacted,
+// except from the end.  Notice, this class does not keep
 // the records align, relying instead on upper levels to take
 // care of non-aligned attributes
 
-class Page {
+class alignas(PAGEALIGN) Page {
 private:
     char 	data[PAGESIZE - DPFIXED]; 
-    slot_t 	slot[1]; // first element of slot array - grows backwards!
+    slot_t 	slot0;   // first element of slot array - grows backwards!
     short	slotCnt; // number of slots in use;
     short	freePtr; // offset of first free byte in data[]
-    short	freeSpace; // number of bytes free in data[]
-    short	dummy;	// for alignment purposes
+    short	freeSpace; // number of bytes free in data[], holes included
+    short	freeSlot; // first free slot, NOSLOT if none
     int		nextPage; // forwards pointer
     int		curPage;  // page number of current pointer
+    LSN		lsn;      // last logged change to the page, 0 if none
+
+    // bytes free between the records and the slot array
+    int contiguousSpace() const
+    {
+	return (int)(PAGESIZE - DPFIXED) - freePtr + slotCnt * (int)sizeof(slot_t);
+    }
+    void compact();      // close the holes left by deleted records
+
+    // slot i, from 0 down to slotCnt+1.  The array grows back from
+    // slot0 into data[], so it is reached from the page's address; an
+    // index off a one-element array would let the compiler assume
+    // every index is 0.
+    slot_t& slot(const int i)
+    {
+	return ((slot_t*)((char*)this + offsetof(Page, slot0)))[i];
+    }
+    const slot_t& slot(const int i) const
+    {
+	return ((const slot_t*)((const char*)this + offsetof(Page, slot0)))[i];
+    }
 
 public:
     void init(const int pageNo); // initialize a new page
+    void initPax(const int pageNo, const int recLen); // ... as a PAX page
     void dumpPage() const;       // dump contents of a page
 
     const Status getNextPage(int& pageNo) const; // returns value of nextPage
     const Status setNextPage(const int pageNo); // sets value of nextPage to pageNo
     const short getFreeSpace() const; // returns amount of free space
+    int getPageNo() const { return curPage; } // as given to init
+
+    // the LSN of the last logged change, for the buffer manager to
+    // force the log that far before writing the page, and for
+    // recovery to skip the changes the page already has
+    LSN getLSN() const { return lsn; }
+    void setLSN(const LSN newLsn) { lsn = newLsn; }
 
     // inserts a new record (rec) into the page, returns RID of record 
     const Status insertRecord(const Record & rec, RID& rid);
 
+    // inserts rec in a new slot after the last one, without looking
+    // for a free slot first; for filling a fresh page
+    const Status appendRecord(const Record & rec, RID& rid);
+
     // delete the record with the specified rid
     const Status deleteRecord(const RID & rid);
 
@@ -68,8 +137,36 @@ public:
     // returns ENDOFPAGE if no more records exist on the page
     const Status nextRecord (const RID & curRid, RID& nextRid) const;
 
-    // returns reference to record with RID rid
+    // returns reference to record with RID rid; INVALIDSLOTNO on a PAX
+    // page, whose records are not in one piece
     const Status getRecord(const RID & rid, Record & rec);
+
+    // as above, but a record of a PAX page is put together in buf,
+    // which must hold PAGESIZE bytes
+    const Status getRecord(const RID & rid, Record & rec, char* buf) const;
+
+    bool isPax() const { return freeSlot == PAXPAGE; }
+    // records a PAX page of records of recLen bytes holds; 0 if none fit
+    static int paxCapacity(const int recLen);
+    int paxSlots() const { return slotCnt; }    // its capacity
+    bool paxUsed(const int slotNo) const { return data[slotNo] != 0; }
+    // minipage w, word w of the record in each place
+    const int* paxColumn(const int w) const
+    {
+	return (const int*)&data[paxColumnAt(slotCnt, w)];
+    }
+    // copy length bytes from offset of the record at slotNo into buf
+    void paxAttr(const int slotNo, const int offset, const int length,
+		 char* buf) const;
+
+private:
+    static int paxColumnAt(const int capacity, const int w)
+    {
+	return (capacity + 3) / 4 * 4 + w * capacity * (int)sizeof(int);
+    }
+    void paxStore(const int slotNo, const char* rec);
 };
 
+static_assert(sizeof(Page) == PAGESIZE, "Page must fill exactly PAGESIZE bytes");
+
 #endif
@@ -0,0 +1,96 @@
+#ifndef PARSCAN_H
+#define PARSCAN_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include "heapfile.h"
+
+const int MORSELPAGES = 16;    // data pages handed to a worker at a time
+
+// A filtered scan of a heap file run by several threads.  The calling
+// thread reads the file's page directory and deals the pages out in
+// morsels of MORSELPAGES pages to the workers, round robin; a worker
+// whose own queue is empty steals the newest morsel of another.  Each
+// worker filters its pages with a HeapFileScan of its own.  The
+// dealing stays at most two morsels per worker ahead of the workers,
+// which bounds what an ordered scan has to hold back.
+class ParallelScan : public HeapFile
+{
+public:
+  // called for every matching record, by worker 0..numThreads-1;
+  // rec is only valid during the call
+  typedef function<void(const int worker, const RID & rid,
+			 const Record & rec)> Emit;
+
+  ParallelScan(const string & name, Status & status);
+  ~ParallelScan();
+
+  // same filters as HeapFileScan::startScan
+  const Status startScan(const int offset,
+			 const int length,
+			 const Datatype type,
+			 const char* filter,
+			 const Operator op);
+  const Status startScan(const ScanPred* preds,
+			 const int numPreds,
+			 const bool conjunctive = true);
+
+  // Scan the file on numThreads workers, calling emit for each match.
+  // Unordered, the workers call emit concurrently as they go.
+  // Ordered, the matches are buffered and emit is called by one
+  // thread at a time, in the order a HeapFileScan returns them.
+  const Status run(const int numThreads, const Emit & emit,
+		   const bool ordered = false);
+
+private:
+  struct Morsel {
+    int seq;                   // position in the page chain
+    int numPages;
+    int pages[MORSELPAGES];
+  };
+
+  // the matches of a morsel of an ordered scan, waiting their turn
+  struct Output {
+    vector<RID> rids;
+    vector<int> lengths;
+    vector<char> data;         // the records, back to back
+  };
+
+  struct WorkQueue {
+    std::mutex latch;
+    deque<Morsel> morsels;
+  };
+
+  string fileName;
+  vector<ScanPred> preds;
+  bool conjunctive;
+
+  // state of a run
+  int numThreads;
+  bool ordered;
+  const Emit* emit;
+  WorkQueue* queues;
+  std::mutex runLatch;         // protects the counts and flags below
+  std::condition_variable workReady;  // morsel queued or walk over
+  std::condition_variable workDone;   // morsel finished
+  int dealt;                   // morsels queued so far
+  int finished;                // morsels filtered so far
+  bool walkDone;
+  Status runStatus;            // first error of the run
+  std::mutex outLatch;         // held while emitting, when ordered
+  map<int, Output> pending;    // finished out of turn
+  int nextSeq;                 // next morsel to emit
+
+  const Status walk();
+  void worker(const int id);
+  bool nextMorsel(const int id, Morsel & morsel);
+  bool takeMorsel(const int id, Morsel & morsel);
+  void deliver(const int id, const int seq, Output & out);
+  void emitOutput(const int id, const Output & out);
+  void fail(const Status status);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+// A free list of blocks the size of a T, carved from chunks of CHUNK
+// blocks, for small objects that are made and freed often.  Freed
+// blocks are kept for the next alloc; the chunks are only released
+// with the Slab.  Callers construct and destroy the objects in place.
+// Not thread-safe.
+template <class T, int CHUNK = 32>
+class Slab
+{
+public:
+  Slab() : freeList(NULL), chunks(NULL) {}
+  ~Slab()
+  {
+    while (chunks != NULL) {
+      Chunk* next = chunks->next;
+      delete chunks;
+      chunks = next;
+    }
+  }
+
+  void* alloc()
+  {
+    if (freeList == NULL) grow();
+    Block* b = freeList;
+    freeList = b->next;
+    return b;
+  }
+
+  void release(void* p)
+  {
+    if (p == NULL) return;
+    Block* b = (Block*)p;
+    b->next = freeList;
+    freeList = b;
+  }
+
+private:
+  union Block {
+    Block* next;
+    alignas(T) char obj[sizeof(T)];
+  };
+  struct Chunk {
+    Block blocks[CHUNK];
+    Chunk* next;
+  };
+
+  Block* freeList;
+  Chunk* chunks;
+
+  void grow()
+  {
+    Chunk* c = new Chunk;
+    c->next = chunks;
+    chunks = c;
+    for (int i = CHUNK - 1; i >= 0; i--) release(&c->blocks[i]);
+  }
+
+  Slab(const Slab&);
+  Slab& operator=(const Slab&);
+};
+
+#endif
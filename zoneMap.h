@@ -0,0 +1,65 @@
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+
+#include "index.h"
+
+// zone pages the header can list
+const int ZONEDIRPAGES = PAGESIZE / sizeof(int) - 5;
+
+// header page of a zone map file.  The zone of data page p of the
+// heap file is entry p % zonesPerPage of zone page
+// zonePages[p / zonesPerPage].
+struct ZoneHdr
+{
+  int		offset;		// the attribute summarized
+  int		length;
+  Datatype	type;
+  int		numZonePages;
+  int		zonePages[ZONEDIRPAGES];
+};
+
+static_assert(sizeof(ZoneHdr) <= PAGESIZE, "ZoneHdr must fit on a page");
+
+// A zone map of a heap file attribute: for every data page, the least
+// and greatest value of the attribute on it, so a scan can pass over
+// pages that cannot hold a match without reading them.  A zone is a
+// flag byte, set once the page has had a record, then the minimum
+// and the maximum.  Inserts widen the zone of their page; deletes
+// leave it alone, so a zone may be wider than its page's records but
+// never narrower.  It is registered and kept up to date like an
+// index, but it answers no index scans.
+class ZoneMap : public Index
+{
+public:
+  ZoneMap(const IndexDesc & desc, Status & status);
+  ~ZoneMap();
+
+  // create the zone map file desc names and fill it from the records
+  // of the scan, which must have been started unfiltered
+  static const Status build(const IndexDesc & desc, HeapFileScan & scan);
+
+  const Status insertEntry(const char* key, const RID & rid);
+  const Status deleteEntry(const char* key, const RID & rid) { return OK; }
+
+  bool supports(const Operator op) const { return false; }
+  const Status startScan(const char* filter, const Operator op)
+    { return BADSCANPARM; }
+  const Status scanNext(RID & rid) { return NOMORERECS; }
+  const Status endScan() { return OK; }
+
+  // set may unless no record on data page pageNo can satisfy op *filter
+  const Status mayMatch(const int pageNo, const char* filter,
+			const Operator op, bool & may);
+
+private:
+  File*		file;
+  ZoneHdr*	hdr;		// pinned header page
+  int		hdrPageNo;
+  bool		hdrDirty;
+  int		zoneLen;	// bytes of a zone
+  int		zonesPerPage;
+  int		zonePageNo;	// zone page mayMatch last read, kept
+  Page*		zonePage;	// pinned; NULL if none
+};
+
+#endif